@@ -41,3 +41,12 @@ int claim_cnt(counter_t *c, int limit, int inc) {
   return ret;
 }
 
+// claim count that returns the claimed index
+int claim_idx_cnt(counter_t *c, int limit) {
+  pthread_mutex_lock(&c->lock);
+  int idx = c->value + 1 <= limit ? c->value : -1;
+  if (idx >= 0) c->value += 1;
+  pthread_mutex_unlock(&c->lock);
+
+  return idx;
+}
@@ -25,4 +25,7 @@ void increment_cnt(counter_t *c);
 /// increments the counter by `n` iff it won't go past `limit` (can equal)
 /// returns 1 if increments, 0 if it doesn't
 int claim_cnt(counter_t *c, int limit, int n);
+/// increments the counter by one iff it won't go past `limit` (can equal)
+/// returns the value before incrementing, or -1 if it doesn't
+int claim_idx_cnt(counter_t *c, int limit);
 int get_cnt(counter_t *c);
@@ -17,23 +17,45 @@
 #include <time.h>
 #include "matrix.h"
 #include "pcmatrix.h"
+#include "slab.h"
 
 
+// Draws from the per-matrix stream `state`, or the shared rand() stream if NULL
+static int NextRand(unsigned int *state)
+{
+  return state != NULL ? rand_r(state) : rand();
+}
+
+// Mixes (seed, idx) into a rand_r state so neighbouring indices get unrelated streams
+static unsigned int SeedState(unsigned int seed, int idx)
+{
+  unsigned long long z = ((unsigned long long) seed << 32) + (unsigned int) idx + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return (unsigned int) (z ^ (z >> 31));
+}
+
+static void GenMatrixState(Matrix * mat, unsigned int *state);
+static Matrix * GenMatrixRandomState(unsigned int *state);
+
 // MATRIX ROUTINES
 Matrix * AllocMatrix(int r, int c)
 {
+  // one block: the header, then the row pointers, then the rows back to back
   Matrix * mat;
-  mat = (Matrix *) malloc(sizeof(Matrix));
+  mat = (Matrix *) slab_alloc(sizeof(Matrix) + sizeof(int *) * r + sizeof(int) * r * c);
+  assert(mat != 0);
   int ** a;
   int i;
-  a = (int**) malloc(sizeof(int *) * r);
-  assert(a != 0);
+  a = (int **) (mat + 1);
+  int * data = (int *) (a + r);
   for (i = 0; i < r; i++)
   {
-    a[i] = (int *) malloc(c * sizeof(int));
-    assert(a[i] != 0);
+    a[i] = data + i * c;
   }
   mat->m=a;
+  mat->id=-1;
+  mat->put_ns=0;
   mat->rows=r;
   mat->cols=c;
   return mat;
@@ -41,19 +63,16 @@ Matrix * AllocMatrix(int r, int c)
 
 void FreeMatrix(Matrix * mat)
 {
-  int r = mat->rows;
-  //int c = mat->cols;
-  int **a = mat->m;
-  int i;
-  for (i=0; i<r; i++)
-  {
-    free(a[i]);
-  }
-  free(a);
-  free(mat);
+  // rows and row pointers live in the same block as the header
+  slab_free(mat);
 }
 
 void GenMatrix(Matrix * mat)
+{
+  GenMatrixState(mat, NULL);
+}
+
+static void GenMatrixState(Matrix * mat, unsigned int *state)
 {
   int height = mat->rows;
   int width = mat->cols;
@@ -65,7 +84,7 @@ void GenMatrix(Matrix * mat)
     {
       int * mm = a[i];
       if (MATRIX_MODE == 0)
-        mm[j] = 1 + rand() % 10;
+        mm[j] = 1 + NextRand(state) % 10;
       else
         mm[j] = 1;
 #if OUTPUT
@@ -76,13 +95,32 @@ void GenMatrix(Matrix * mat)
 }
 
 Matrix * GenMatrixRandom()
+{
+  return GenMatrixRandomState(NULL);
+}
+
+// Matrix `idx` of the workload, its shape and contents depend only on (seed, idx)
+// The caller owns numbering and sets `id`
+Matrix * GenMatrixSeeded(unsigned int seed, int idx)
+{
+  unsigned int state = SeedState(seed, idx);
+  return GenMatrixRandomState(&state);
+}
+
+static Matrix * GenMatrixRandomState(unsigned int *state)
 {
   int row;
   int col;
-  if (MATRIX_MODE ==0)
+  if (MATRIX_MODE == 0 && MIX_SIZE > 0 && NextRand(state) % MIX_EVERY == 0)
   {
-    row = 1 + rand() % 4;
-    col = 1 + rand() % 4;
+    // the occasional large matrix of the mixed workload
+    row = MIX_SIZE;
+    col = MIX_SIZE;
+  }
+  else if (MATRIX_MODE ==0)
+  {
+    row = 1 + NextRand(state) % 4;
+    col = 1 + NextRand(state) % 4;
   }
   else
   {
@@ -90,7 +128,7 @@ Matrix * GenMatrixRandom()
     col = MATRIX_MODE;
   }
   Matrix * mat = AllocMatrix(row, col);
-  GenMatrix(mat);
+  GenMatrixState(mat, state);
   return mat;
 }
 
@@ -111,7 +149,6 @@ Matrix * MatrixMultiply(Matrix * m1, Matrix * m2)
   {
     return NULL;
   }
-  printf("MULTIPLY (%d x %d) BY (%d x %d):\n",m1->rows,m1->cols,m2->rows,m2->cols);
   Matrix * newmat = AllocMatrix(m1->rows, m2->cols);
   int ** nm = newmat->m;
   int ** ma1 = m1->m;
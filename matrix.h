@@ -10,6 +10,10 @@
 #define COL 5
 
 typedef struct matrix {
+  /// index of the matrix in the workload, -1 if not produced by a worker
+  int id;
+  /// CLOCK_MONOTONIC ns at which it was `put`, 0 unless latency is being recorded
+  unsigned long long put_ns;
   int rows;
   int cols;
   int **m;
@@ -22,6 +26,7 @@ Matrix *AllocMatrix(int r, int c);
 void FreeMatrix(Matrix *mat);
 void GenMatrix(Matrix *mat);
 Matrix *GenMatrixRandom();
+Matrix *GenMatrixSeeded(unsigned int seed, int idx);
 int AvgElement(Matrix *mat);
 int SumMatrix(Matrix *mat);
 Matrix *MatrixMultiply(Matrix *m1, Matrix *m2);
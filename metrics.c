@@ -0,0 +1,180 @@
+/*
+ *  metrics module
+ *  Live periodic metrics reporter
+ *
+ *  Workers bump counters in their own metrics_slot_t, and an optional
+ *  reporter thread sums every slot each interval and prints a single
+ *  key=value line with totals, buffer occupancy, and per-interval rates.
+ *
+ *  University of Washington, Tacoma
+ *  TCSS 422 - Operating Systems
+ */
+
+// Include libraries required for this module only
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include "matrix.h"
+#include "prodcons.h"
+#include "metrics.h"
+
+/// One slot per worker thread
+metrics_slot_t *metrics_slots = NULL;
+int metrics_nslots = 0;
+/// Next slot to hand out in `metrics_register`
+atomic_int metrics_next_slot = 0;
+
+/// Reporter thread state
+pthread_t metrics_thread;
+bool metrics_running = false;
+FILE *metrics_stream = NULL;
+int metrics_interval_ms = 0;
+
+/// Protects metrics_stop_requested, used to wake the reporter early on stop
+pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t metrics_stop_cond = PTHREAD_COND_INITIALIZER;
+bool metrics_stop_requested = false;
+
+/// Totals summed over every slot
+typedef struct __metrics_snapshot_t {
+  size_t produced;
+  size_t consumed;
+  size_t multiplied;
+} metrics_snapshot_t;
+
+int metrics_init(int nslots) {
+  assert(nslots > 0 && "must have at least one slot");
+
+  metrics_slots = aligned_alloc(64, sizeof(metrics_slot_t) * nslots);
+  if (metrics_slots == NULL) return -1;
+
+  for (int i = 0; i < nslots; i++) {
+    atomic_init(&metrics_slots[i].produced, 0);
+    atomic_init(&metrics_slots[i].consumed, 0);
+    atomic_init(&metrics_slots[i].multiplied, 0);
+  }
+
+  metrics_nslots = nslots;
+  atomic_store(&metrics_next_slot, 0);
+  return 0;
+}
+
+metrics_slot_t *metrics_register() {
+  int idx = atomic_fetch_add(&metrics_next_slot, 1);
+  assert(idx < metrics_nslots && "more workers registered than slots allocated");
+  return &metrics_slots[idx];
+}
+
+static metrics_snapshot_t metrics_collect() {
+  metrics_snapshot_t snap = {0, 0, 0};
+  for (int i = 0; i < metrics_nslots; i++) {
+    snap.produced   += atomic_load_explicit(&metrics_slots[i].produced,   memory_order_relaxed);
+    snap.consumed   += atomic_load_explicit(&metrics_slots[i].consumed,   memory_order_relaxed);
+    snap.multiplied += atomic_load_explicit(&metrics_slots[i].multiplied, memory_order_relaxed);
+  }
+  return snap;
+}
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to) {
+  return (to->tv_sec - from->tv_sec) * 1e3 + (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/// prints one machine-parsable line, rates are per second over the last interval
+static void metrics_report(const struct timespec *start, const struct timespec *now, double interval_ms,
+                           metrics_snapshot_t *last, bool final) {
+  metrics_snapshot_t snap = metrics_collect();
+  double secs = interval_ms > 0 ? interval_ms / 1e3 : 1;
+
+  fprintf(metrics_stream,
+          "metrics t_ms=%.0f final=%d produced=%zu consumed=%zu multiplied=%zu occupancy=%zu"
+          " produced_rate=%.1f consumed_rate=%.1f multiplied_rate=%.1f\n",
+          elapsed_ms(start, now), final, snap.produced, snap.consumed, snap.multiplied, occupancy(),
+          (snap.produced - last->produced) / secs,
+          (snap.consumed - last->consumed) / secs,
+          (snap.multiplied - last->multiplied) / secs);
+  fflush(metrics_stream);
+
+  *last = snap;
+}
+
+// Metrics REPORTER thread
+static void *metrics_worker(void *arg) {
+  (void) arg;
+  struct timespec start, prev, now, deadline;
+  metrics_snapshot_t last = {0, 0, 0};
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  prev = start;
+  deadline = start;
+
+  pthread_mutex_lock(&metrics_mutex);
+  while (!metrics_stop_requested) {
+    // next wake up, relative to the previous deadline so the period doesn't drift
+    deadline.tv_sec += metrics_interval_ms / 1000;
+    deadline.tv_nsec += (long) (metrics_interval_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    int rc = 0;
+    while (!metrics_stop_requested && rc != ETIMEDOUT) {
+      rc = pthread_cond_timedwait(&metrics_stop_cond, &metrics_mutex, &deadline);
+    }
+    if (metrics_stop_requested) break;
+
+    pthread_mutex_unlock(&metrics_mutex);
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      metrics_report(&start, &now, elapsed_ms(&prev, &now), &last, false);
+      prev = now;
+    pthread_mutex_lock(&metrics_mutex);
+  }
+  pthread_mutex_unlock(&metrics_mutex);
+
+  // final snapshot so the totals are always on record
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  metrics_report(&start, &now, elapsed_ms(&prev, &now), &last, true);
+  return NULL;
+}
+
+int metrics_start(FILE *stream, int interval_ms) {
+  assert(stream != NULL);
+  assert(interval_ms > 0 && "interval must be positive");
+  assert(metrics_slots != NULL && "metrics_init must be called first");
+
+  metrics_stream = stream;
+  metrics_interval_ms = interval_ms;
+  metrics_stop_requested = false;
+
+  // timedwait deadlines are computed on CLOCK_MONOTONIC
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_destroy(&metrics_stop_cond);
+  pthread_cond_init(&metrics_stop_cond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  if (pthread_create(&metrics_thread, NULL, metrics_worker, NULL) != 0) return -1;
+  metrics_running = true;
+  return 0;
+}
+
+void metrics_stop() {
+  if (metrics_running) {
+    pthread_mutex_lock(&metrics_mutex);
+      metrics_stop_requested = true;
+      pthread_cond_signal(&metrics_stop_cond);
+    pthread_mutex_unlock(&metrics_mutex);
+
+    pthread_join(metrics_thread, NULL);
+    metrics_running = false;
+  }
+
+  free(metrics_slots);
+  metrics_slots = NULL;
+  metrics_nslots = 0;
+}
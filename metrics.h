@@ -0,0 +1,37 @@
+/*
+ *  metrics header
+ *  Function prototypes, data, and constants for the live metrics reporter module
+ *
+ *  University of Washington, Tacoma
+ *  TCSS 422 - Operating Systems
+ */
+
+#include <stdatomic.h>
+
+// LIVE METRICS
+
+/// Per-thread counters. Each worker owns exactly one slot and is the only writer,
+/// so updates are relaxed load/store pairs (no lock, no RMW) and the reporter
+/// thread only ever reads them. Aligned to a cache line so workers don't false share.
+typedef struct __metrics_slot_t {
+  _Atomic size_t produced;
+  _Atomic size_t consumed;
+  _Atomic size_t multiplied;
+} __attribute__((aligned(64))) metrics_slot_t;
+
+/// bumps a slot counter, only call from the thread that owns the slot
+static inline void metrics_inc(_Atomic size_t *cnt) {
+  atomic_store_explicit(cnt, atomic_load_explicit(cnt, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+// metrics methods
+/// allocates `nslots` slots, must be called before any worker is created
+/// returns -1 if it failed to allocate
+int metrics_init(int nslots);
+/// hands out the next free slot, never NULL once `metrics_init` succeeded
+metrics_slot_t *metrics_register();
+/// starts the reporter thread, writing one line to `stream` every `interval_ms`
+/// returns -1 if the thread could not be created
+int metrics_start(FILE *stream, int interval_ms);
+/// stops and joins the reporter thread (if started) after one final snapshot, frees the slots
+void metrics_stop();
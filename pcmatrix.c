@@ -38,6 +38,9 @@
 #include "counter.h"
 #include "prodcons.h"
 #include "pcmatrix.h"
+#include "metrics.h"
+#include "profile.h"
+#include "slab.h"
 
 int main (int argc, char *argv[]) {
   // Process command line arguments
@@ -45,6 +48,14 @@ int main (int argc, char *argv[]) {
   BOUNDED_BUFFER_SIZE = MAX;
   NUMBER_OF_MATRICES = LOOPS;
   MATRIX_MODE = DEFAULT_MATRIX_MODE;
+  METRICS_INTERVAL_MS = DEFAULT_METRICS_INTERVAL_MS;
+  PROFILE_MODE = DEFAULT_PROFILE_MODE;
+  SEED = DEFAULT_SEED;
+  SLAB_MB = DEFAULT_SLAB_MB;
+  LANE_LIMIT = DEFAULT_LANE_LIMIT;
+  LANE_OVERFLOW = DEFAULT_LANE_OVERFLOW;
+  MIX_SIZE = DEFAULT_MIX_SIZE;
+  MIX_EVERY = DEFAULT_MIX_EVERY;
 
   // this way is much simplier
   if (argc == 1) {
@@ -57,20 +68,66 @@ int main (int argc, char *argv[]) {
     printf("USING: worker_threads=%d bounded_buffer_size=%d matricies=%d matrix_mode=%d\n", numw, BOUNDED_BUFFER_SIZE, NUMBER_OF_MATRICES, MATRIX_MODE);
   }
 
-  // Seed the random number generator with the system time
-  srand((unsigned) time(NULL)); // the time arg should be NULL by man page
+  // optional features are configured through the environment
+  char *env;
+  if ((env = getenv("PCMATRIX_METRICS_MS")) != NULL) METRICS_INTERVAL_MS = atoi(env);
+  if ((env = getenv("PCMATRIX_PROFILE")) != NULL) PROFILE_MODE = atoi(env);
+  if ((env = getenv("PCMATRIX_SEED")) != NULL) SEED = atoi(env);
+  if ((env = getenv("PCMATRIX_SLAB_MB")) != NULL) SLAB_MB = atoi(env);
+  if ((env = getenv("PCMATRIX_LANE_LIMIT")) != NULL) LANE_LIMIT = atoi(env);
+  LANE_LARGE_CONSUMERS = numw / 2;
+  if ((env = getenv("PCMATRIX_LANE_LARGE_CONSUMERS")) != NULL) LANE_LARGE_CONSUMERS = atoi(env);
+  if ((env = getenv("PCMATRIX_LANE_OVERFLOW")) != NULL) LANE_OVERFLOW = atoi(env);
+  if ((env = getenv("PCMATRIX_MIX_SIZE")) != NULL) MIX_SIZE = atoi(env);
+  if ((env = getenv("PCMATRIX_MIX_EVERY")) != NULL) MIX_EVERY = atoi(env);
+  if (MIX_EVERY < 1) MIX_EVERY = 1;
+
+  // without overflow every lane needs at least one consumer of its own
+  if (LANE_LIMIT > 0 && !LANE_OVERFLOW && (LANE_LARGE_CONSUMERS < 1 || LANE_LARGE_CONSUMERS >= numw)) {
+    fprintf(stderr, "pcmatrix: size-class routing needs 1 <= large consumers (%d) < worker threads (%d), or overflow\n",
+            LANE_LARGE_CONSUMERS, numw);
+    return 1;
+  }
+
+  // Seed the random number generator with the system time, unless the workload is seeded
+  if (SEED < 0) srand((unsigned) time(NULL)); // the time arg should be NULL by man page
+
+  // open the record of multiplied pairs if asked for
+  FILE *record_out = NULL;
+  if ((env = getenv("PCMATRIX_RECORD")) != NULL) {
+    if ((record_out = fopen(env, "w")) == NULL) {
+      perror("pcmatrix: fopen");
+      return 1;
+    }
+    if (record_init(NUMBER_OF_MATRICES / 2 + 1) != 0) {
+      perror("pcmatrix: record_init");
+      return 1;
+    }
+  }
 
   printf("Producing %d matrices in mode %d.\n", NUMBER_OF_MATRICES, MATRIX_MODE);
   printf("Using a shared buffer of size=%d\n", BOUNDED_BUFFER_SIZE);
   printf("With %d producer and consumer thread(s).\n", numw);
+  if (MATRIX_MODE == 0 && MIX_SIZE > 0)
+    printf("Mixed workload, about 1 in %d matrices is %dx%d.\n", MIX_EVERY, MIX_SIZE, MIX_SIZE);
+  if (SEED >= 0) printf("Deterministic workload with seed=%d.\n", SEED);
+  if (LANE_LIMIT > 0)
+    printf("Routing matrices with more than %d elements to %d large lane consumer(s), overflow %s.\n",
+           LANE_LIMIT, LANE_LARGE_CONSUMERS, LANE_OVERFLOW ? "on" : "off");
   printf("\n");
 
+  // reserve the slab matrices and big matrix are carved from
+  if (slab_init((size_t) (SLAB_MB > 0 ? SLAB_MB : 0) << 20) != 0) {
+    perror("pcmatrix: slab_init");
+    return 1;
+  }
+
   // allocate to big matrix
-  bigmatrix = calloc(BOUNDED_BUFFER_SIZE, sizeof(Matrix *));
+  bigmatrix = slab_calloc((size_t) BOUNDED_BUFFER_SIZE * lanes(), sizeof(Matrix *));
 
   // check if allocation failed
   if (bigmatrix == NULL) {
-    perror("pcmatrix: calloc");
+    perror("pcmatrix: slab_calloc");
     return 1;
   }
 
@@ -83,6 +140,37 @@ int main (int argc, char *argv[]) {
     return 1;
   }
 
+  // per size class latency, only when there is more than one class to compare
+  if ((LANE_LIMIT > 0 || MIX_SIZE > 0) && latency_init(NUMBER_OF_MATRICES / 2 + 1) != 0) {
+    perror("pcmatrix: latency_init");
+    return 1;
+  }
+
+  // one live metrics slot per worker
+  if (metrics_init(numw * 2) != 0) {
+    perror("pcmatrix: metrics_init");
+    return 1;
+  }
+
+  // per-thread profiling counters, only if asked for
+  if (PROFILE_MODE && profile_init(numw * 2) != 0) {
+    perror("pcmatrix: profile_init");
+    return 1;
+  }
+
+  // start the reporter if asked for
+  FILE *metrics_out = stderr;
+  if (METRICS_INTERVAL_MS > 0) {
+    if ((env = getenv("PCMATRIX_METRICS_FILE")) != NULL && (metrics_out = fopen(env, "w")) == NULL) {
+      perror("pcmatrix: fopen");
+      return 1;
+    }
+    if (metrics_start(metrics_out, METRICS_INTERVAL_MS) != 0) {
+      perror("pcmatrix: metrics_start");
+      return 1;
+    }
+  }
+
   // declare counters
   counter_t producer_counter, consumer_counter;
 
@@ -122,14 +210,28 @@ int main (int argc, char *argv[]) {
     }
   }
 
+  // final snapshot and stop the reporter
+  metrics_stop();
+  if (metrics_out != stderr) fclose(metrics_out);
+  if (record_out != NULL) {
+    record_flush(record_out);
+    fclose(record_out);
+  }
+
   printf("Sum of Matrix elements --> Produced=%zu = Consumed=%zu\n", prod_sum, cons_sum);
   printf("Matrices produced=%zu consumed=%zu multiplied=%zu\n", prod, cons, cons_mul);
 
-  for (int i = 0; i < BOUNDED_BUFFER_SIZE; i++) assert(bigmatrix[i] == NULL);
+  // per-phase table, no-op unless profiling
+  profile_report(stdout);
+  latency_report(stdout);
+  if (SLAB_MB > 0) slab_report(stdout);
+
+  for (int i = 0; i < BOUNDED_BUFFER_SIZE * lanes(); i++) assert(bigmatrix[i] == NULL);
 
   // free
-  free(bigmatrix);
+  slab_free(bigmatrix);
   free(workers);
+  slab_destroy();
 
   return 0;
 }
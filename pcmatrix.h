@@ -29,4 +29,64 @@ int NUMBER_OF_MATRICES;
 /// Should be a `size_t` and set to `DEFAULT_MATRIX_MODE`
 int MATRIX_MODE;
 
+// DETERMINISTIC WORKLOAD
+// Set with env PCMATRIX_SEED
+// -1 - rand() seeded with the time, shared by every producer
+// 0-n - matrix i depends only on (seed, i), so sums are reproducible at any thread count
+#define DEFAULT_SEED -1
+int SEED;
+// RECORD
+// Set env PCMATRIX_RECORD to a file path to record every multiplied pair in pairing order, one line each:
+//   pair lhs=<id> rhs=<id> lhs_shape=<r>x<c> rhs_shape=<r>x<c> sum=<sum of product>
+// With a seed and no routing, matrices are handed out and paired in id order exactly as one consumer would,
+// so the record and the multiplied count are identical at any thread count and can be diffed directly.
+// Unseeded or routed, pairing depends on thread interleaving and the record only reproduces at one consumer
+
+// SIZE-CLASS ROUTING
+// Matrices with more than LANE_LIMIT elements go to a separate large lane, set with env PCMATRIX_LANE_LIMIT
+// 0 - routing disabled, one shared FIFO
+#define DEFAULT_LANE_LIMIT 0
+int LANE_LIMIT;
+// Number of consumers serving the large lane, the rest serve the small lane
+// Set with env PCMATRIX_LANE_LARGE_CONSUMERS, defaults to half of the consumers
+int LANE_LARGE_CONSUMERS;
+// Set with env PCMATRIX_LANE_OVERFLOW
+// 0 - consumers only take from their own lane
+// 1 - consumers whose lane is empty help with the other lane
+#define DEFAULT_LANE_OVERFLOW 0
+int LANE_OVERFLOW;
+// MIXED WORKLOAD, only applies to matrix mode 0
+// Set with env PCMATRIX_MIX_SIZE
+// 0 - off
+// n - about one in MIX_EVERY matrices is a random n x n matrix instead of 1..4 x 1..4
+#define DEFAULT_MIX_SIZE 0
+int MIX_SIZE;
+// Set with env PCMATRIX_MIX_EVERY
+#define DEFAULT_MIX_EVERY 16
+int MIX_EVERY;
+// Per size class put-to-get and get-to-multiply latency (p50/p99) is printed at exit
+// whenever routing or the mixed workload is on, so routed and unrouted runs can be compared
+
+// HUGE-PAGE SLAB
+// Size in MB of the slab matrices and the ring buffer are carved from, set with env PCMATRIX_SLAB_MB
+// 0 - disabled, everything comes from malloc
+// Backed by 1GB/2MB hugetlb pages when reserved, else a transparent huge page hint, else normal pages
+// Compare dtlb_misses with PCMATRIX_PROFILE=1 between runs with and without the slab
+#define DEFAULT_SLAB_MB 0
+int SLAB_MB;
+
+// LIVE METRICS REPORTER
+// Interval in milliseconds between snapshots, set with env PCMATRIX_METRICS_MS
+// 0 - reporter disabled
+// Snapshots go to stderr, or to the file named by env PCMATRIX_METRICS_FILE
+#define DEFAULT_METRICS_INTERVAL_MS 0
+int METRICS_INTERVAL_MS;
+
+// PER-PHASE PROFILING
+// Set with env PCMATRIX_PROFILE
+// 0 - disabled
+// 1 - per-thread perf_event counters (clock timing if denied), table printed at exit
+#define DEFAULT_PROFILE_MODE 0
+int PROFILE_MODE;
+
 // #define DEBUG(str, ...) fprintf(stderr, "%s:%d: "str"\n", __FILE__, __LINE__ __VA_OPT__(,) __VA_ARGS__)
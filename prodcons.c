@@ -13,33 +13,147 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include <assert.h>
+#include <time.h>
 #include "counter.h"
 #include "matrix.h"
 #include "pcmatrix.h"
 #include "prodcons.h"
+#include "metrics.h"
+#include "profile.h"
 
 // Define Locks, Condition variables, and so on here
 /// Locks stdout so only one prints at a time.
 pthread_mutex_t stdout_lock = PTHREAD_MUTEX_INITIALIZER;
 
-/// Protects bigmatrix, bounded_buffer_write_idx, and bounded_buffer_readable
+/// Protects bigmatrix and every bounded_buffer_* variable below, for all lanes
 pthread_mutex_t bounded_buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
-/// Protects bigmatrix, wait on if you are trying to put
-pthread_cond_t bounded_buffer_put_cond = PTHREAD_COND_INITIALIZER;
-/// Protects bigmatrix, wait on if you are trying to get
-pthread_cond_t bounded_buffer_get_cond = PTHREAD_COND_INITIALIZER;
+/// Protects a lane of bigmatrix, wait on if you are trying to put into it
+pthread_cond_t bounded_buffer_put_cond[LANES] = { PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+/// Protects a lane of bigmatrix, wait on if you are trying to get from it
+pthread_cond_t bounded_buffer_get_cond[LANES] = { PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
 
-/// Write head into the ring buffer
+/// Write head into each lane's ring buffer
 /// protected by bounded_buffer_mutex
-size_t bounded_buffer_write_idx = 0;
-/// The number of entries readable behind the `bounded_buffer_write_idx`
+size_t bounded_buffer_write_idx[LANES] = { 0, 0 };
+/// The number of entries readable behind each lane's `bounded_buffer_write_idx`
 /// protected by bounded_buffer_mutex
-size_t bounded_buffer_readable = 0;
+size_t bounded_buffer_readable[LANES] = { 0, 0 };
+/// The number of consumers blocked in `get_lane` on each lane
+/// protected by bounded_buffer_mutex
+size_t bounded_buffer_waiting[LANES] = { 0, 0 };
+/// The number of those that were signalled but haven't woken up yet
+/// protected by bounded_buffer_mutex
+size_t bounded_buffer_signalled[LANES] = { 0, 0 };
+/// The number of matrices `put` so far across all lanes
+/// protected by bounded_buffer_mutex
+size_t bounded_buffer_put_total = 0;
+/// Id of the next matrix to hand out when `ordered`
+/// protected by bounded_buffer_mutex
+size_t bounded_buffer_read_next = 0;
+
+/// Held by the consumer choosing the next pair when `ordered`, so pairs follow id order
+pthread_mutex_t pairing_lock = PTHREAD_MUTEX_INITIALIZER;
+/// Index of the next pair chosen, used to keep the record in pairing order
+atomic_int next_pair = 0;
+
+/// Whether matrices are handed out and paired in id order, i.e. the seeded workload without routing.
+/// Pairing then matches a single consumer's no matter how many consumers run.
+static bool ordered() {
+  return SEED >= 0 && LANE_LIMIT <= 0;
+}
+
+/// Next consumer to be assigned a lane in `consumer_lane`
+atomic_int next_consumer = 0;
+
+/// The number of lanes in use, 1 unless size-class routing is enabled
+int lanes() {
+  return LANE_LIMIT > 0 ? LANES : 1;
+}
+
+/// The size class of a matrix, by `LANE_LIMIT` if set, else anything bigger than the 4x4 of matrix mode 0
+int size_class(Matrix *value) {
+  int limit = LANE_LIMIT > 0 ? LANE_LIMIT : 16;
+  return value->rows * value->cols > limit ? LANE_LARGE : LANE_SMALL;
+}
+
+/// The lane a matrix is routed to
+int lane_of(Matrix *value) {
+  if (LANE_LIMIT <= 0) return LANE_SMALL;
+  return size_class(value);
+}
+
+/// Latency samples in ns per size class, NULL unless `latency_init` was called
+/// only consumers write, each to a slot reserved with latency_count
+unsigned long long *latency_queue[LANES] = { NULL, NULL };
+unsigned long long *latency_mult[LANES] = { NULL, NULL };
+size_t latency_capacity = 0;
+atomic_size_t latency_count[LANES];
+
+static unsigned long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// Thread safe
+/// The lane the calling consumer serves, the first `LANE_LARGE_CONSUMERS` to ask get the large lane.
+int consumer_lane() {
+  if (LANE_LIMIT <= 0) return LANE_SMALL;
+  return atomic_fetch_add(&next_consumer, 1) < LANE_LARGE_CONSUMERS ? LANE_LARGE : LANE_SMALL;
+}
+
+/// Removes the oldest entry of `lane`, bounded_buffer_mutex must be held and the lane non-empty.
+static Matrix *take(int lane) {
+  Matrix **ring = bigmatrix + (size_t) lane * BOUNDED_BUFFER_SIZE;
+
+  // assert that readable and index are valid
+  assert(bounded_buffer_readable[lane] <= (size_t) BOUNDED_BUFFER_SIZE && "cannot have more readable than slots exist");
+  assert(bounded_buffer_readable[lane] > 0 && "must have something to read");
+  assert(bounded_buffer_write_idx[lane] <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "must have an extra slot open for the read");
+
+  // get index, the slot of the next id when ordered
+  size_t idx = ordered()
+    ? bounded_buffer_read_next % (size_t) BOUNDED_BUFFER_SIZE
+    : (bounded_buffer_write_idx[lane] >= bounded_buffer_readable[lane])
+    ? bounded_buffer_write_idx[lane] - bounded_buffer_readable[lane]
+    : (size_t) BOUNDED_BUFFER_SIZE - (bounded_buffer_readable[lane] - bounded_buffer_write_idx[lane]);
+
+  // assert that index is within the buffer size
+  assert(idx <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "retreival index just be be within the buffer");
+
+  // assert that the entry is filled
+  assert(ring[idx] != NULL && "Entry read be filled (i.e. not NULL)");
+
+  // get the value from the matrix
+  Matrix *value = ring[idx];
+
+  // clear position we just took
+  ring[idx] = NULL; 
+
+  // decrement readable
+  bounded_buffer_readable[lane] -= 1;
+
+  // assert readable is valid
+  assert(bounded_buffer_readable[lane] <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "must have less entries than buffer size (-1 since we just took one)");
+
+  // signal, every producer when ordered since each waits for its own id's slot
+  if (ordered()) {
+    assert((size_t) value->id == bounded_buffer_read_next && "ordered ring must hand out ids in order");
+    bounded_buffer_read_next += 1;
+    pthread_cond_broadcast(&bounded_buffer_put_cond[lane]);
+  } else {
+    pthread_cond_signal(&bounded_buffer_put_cond[lane]);
+  }
+
+  return value;
+}
 
 // Bounded buffer put() get()
 /// Thread safe
+/// Routes `value` to the lane of its size class.
 /// Whomever `get`s the value owns it, do not free it until then.
 /// Returns -1 if it failed to put the value.
 int put(Matrix *value) {
@@ -48,42 +162,72 @@ int put(Matrix *value) {
   assert(value != NULL);
   assert(BOUNDED_BUFFER_SIZE > 0 && "Buffer must be a valid size");
 
+  int lane = lane_of(value);
+  Matrix **ring = bigmatrix + (size_t) lane * BOUNDED_BUFFER_SIZE;
+
   // lock
   pthread_mutex_lock(&bounded_buffer_mutex);
 
     // assert that readable and index sizes for valid sizes
-    assert(bounded_buffer_readable <= (size_t) BOUNDED_BUFFER_SIZE && "cannot have more readable than slots exists");
-    assert(bounded_buffer_write_idx <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "write_idx must be within the buffer");
-
-    while (bounded_buffer_readable == (size_t) BOUNDED_BUFFER_SIZE) {
-      // no space to write, wait until a space opens up.
-      pthread_cond_wait(&bounded_buffer_put_cond, &bounded_buffer_mutex);
+    assert(bounded_buffer_readable[lane] <= (size_t) BOUNDED_BUFFER_SIZE && "cannot have more readable than slots exists");
+    assert(bounded_buffer_write_idx[lane] <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "write_idx must be within the buffer");
+
+    // slot to write, matrix `id` owns slot id % size when ordered
+    size_t slot;
+    if (ordered()) {
+      assert(value->id >= 0 && "ordered ring needs the workload index");
+      while ((size_t) value->id >= bounded_buffer_read_next + (size_t) BOUNDED_BUFFER_SIZE) {
+        // our slot still holds an earlier id, wait until it has been read.
+        pthread_cond_wait(&bounded_buffer_put_cond[lane], &bounded_buffer_mutex);
+      }
+      slot = (size_t) value->id % (size_t) BOUNDED_BUFFER_SIZE;
+    } else {
+      while (bounded_buffer_readable[lane] == (size_t) BOUNDED_BUFFER_SIZE) {
+        // no space to write, wait until a space opens up.
+        pthread_cond_wait(&bounded_buffer_put_cond[lane], &bounded_buffer_mutex);
+      }
+      slot = bounded_buffer_write_idx[lane];
     }
 
     // assert that readable and index sizes for valid sizes
-    assert(bounded_buffer_readable <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "cannot have more readable than slots exist and it musn't be full");
-    assert(bounded_buffer_write_idx <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "must have an extra slot open for the read");
+    assert(bounded_buffer_readable[lane] <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "cannot have more readable than slots exist and it musn't be full");
+    assert(bounded_buffer_write_idx[lane] <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "must have an extra slot open for the read");
     
     // assert than an overridden entry must be cleared
-    assert(bigmatrix[bounded_buffer_write_idx] == NULL && "overridden entry must have been cleared");
+    assert(ring[slot] == NULL && "overridden entry must have been cleared");
 
     // insert into bounded buffer
-    bigmatrix[bounded_buffer_write_idx] = value;
+    if (latency_capacity > 0) value->put_ns = now_ns();
+    ring[slot] = value;
 
     // increment readable
-    bounded_buffer_readable += 1;
+    bounded_buffer_readable[lane] += 1;
+    bounded_buffer_put_total += 1;
 
     // assert that readable size is valid
-    assert(bounded_buffer_readable <= (size_t) BOUNDED_BUFFER_SIZE && "cannot have more readable than space available");
+    assert(bounded_buffer_readable[lane] <= (size_t) BOUNDED_BUFFER_SIZE && "cannot have more readable than space available");
 
-    // increment buffer index
-    bounded_buffer_write_idx = (bounded_buffer_write_idx + 1) % (size_t) BOUNDED_BUFFER_SIZE;
+    // increment buffer index, unused when ordered
+    if (!ordered()) bounded_buffer_write_idx[lane] = (bounded_buffer_write_idx[lane] + 1) % (size_t) BOUNDED_BUFFER_SIZE;
 
     // assert index size is valid
-    assert(bounded_buffer_write_idx <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "new index must be within buffer");
+    assert(bounded_buffer_write_idx[lane] <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "new index must be within buffer");
+
+    // signal to stop wait, handing it to an idle consumer of another lane if nobody on ours is idle.
+    // consumers already signalled for an earlier put don't count as idle
+    int wake = lane;
+    if (LANE_OVERFLOW && bounded_buffer_waiting[lane] == bounded_buffer_signalled[lane]) {
+      for (int other = 0; other < lanes(); other++) {
+        if (bounded_buffer_waiting[other] > bounded_buffer_signalled[other]) { wake = other; break; }
+      }
+    }
+    if (bounded_buffer_waiting[wake] > bounded_buffer_signalled[wake]) bounded_buffer_signalled[wake] += 1;
+    pthread_cond_signal(&bounded_buffer_get_cond[wake]);
 
-    // signal to stop wait
-    pthread_cond_signal(&bounded_buffer_get_cond);
+    // everything has been put, wake every routed consumer so they can see their lane is drained
+    if (LANE_LIMIT > 0 && bounded_buffer_put_total == (size_t) NUMBER_OF_MATRICES) {
+      for (int other = 0; other < lanes(); other++) pthread_cond_broadcast(&bounded_buffer_get_cond[other]);
+    }
 
   // unlock
   pthread_mutex_unlock(&bounded_buffer_mutex);
@@ -91,6 +235,7 @@ int put(Matrix *value) {
 }
 
 /// Thread safe
+/// Gets from the first lane, only use when size-class routing is disabled.
 /// Caller takes ownership of return, and it just be freed.
 /// returns NULL if it failed to reserve a slot
 Matrix * get() {
@@ -100,44 +245,59 @@ Matrix * get() {
   // lock
   pthread_mutex_lock(&bounded_buffer_mutex);
 
-    // assert that readable and index are valid
-    assert(bounded_buffer_readable <= (size_t) BOUNDED_BUFFER_SIZE && "cannot have more readable than slots exists");
-    assert(bounded_buffer_write_idx <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "write_idx must be within the buffer");
-
-    while (bounded_buffer_readable == 0) {
+    // when ordered, wait for the next id specifically
+    while (ordered()
+           ? bigmatrix[bounded_buffer_read_next % (size_t) BOUNDED_BUFFER_SIZE] == NULL
+           : bounded_buffer_readable[LANE_SMALL] == 0) {
       // nothing to read, wait until a slot fills.
-      pthread_cond_wait(&bounded_buffer_get_cond, &bounded_buffer_mutex);
+      pthread_cond_wait(&bounded_buffer_get_cond[LANE_SMALL], &bounded_buffer_mutex);
     }
 
-    // assert that readable and index are valid
-    assert(bounded_buffer_readable <= (size_t) BOUNDED_BUFFER_SIZE && "cannot have more readable than slots exist");
-    assert(bounded_buffer_write_idx <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "must have an extra slot open for the read");
+    // get the value from the matrix
+    Matrix *value = take(LANE_SMALL);
 
-    // get index 
-    size_t idx = (bounded_buffer_write_idx >= bounded_buffer_readable)
-      ? bounded_buffer_write_idx - bounded_buffer_readable
-      : (size_t) BOUNDED_BUFFER_SIZE - (bounded_buffer_readable - bounded_buffer_write_idx);
+  // unlock
+  pthread_mutex_unlock(&bounded_buffer_mutex);
 
-    // assert that index is within the buffer size
-    assert(idx <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "retreival index just be be within the buffer");
+  // return matrix
+  return value;
+}
 
-    // assert that the entry is filled
-    assert(bigmatrix[idx] != NULL && "Entry read be filled (i.e. not NULL)");
+/// Thread safe
+/// Gets from `lane`, or from any other lane when `LANE_OVERFLOW` is set and `lane` is empty.
+/// Stores the lane the matrix came from in `from`.
+/// Caller takes ownership of return, and it just be freed.
+/// returns NULL once every matrix has been put and there is nothing left it may take
+Matrix * get_lane(int lane, int *from) {
+  // asserts that buffer size is greater than 0
+  assert(BOUNDED_BUFFER_SIZE > 0 && "Buffer must be a valid size");
+  assert(lane >= 0 && lane < lanes() && "lane must be in use");
 
-    // get the value from the matrix
-    Matrix *value = bigmatrix[idx];
+  Matrix *value = NULL;
 
-    // clear position we just took
-    bigmatrix[idx] = NULL; 
+  // lock
+  pthread_mutex_lock(&bounded_buffer_mutex);
 
-    // decrement readable
-    bounded_buffer_readable -= 1;
+    for (*from = -1; *from < 0;) {
+      // own lane first, then help out if allowed
+      if (bounded_buffer_readable[lane] > 0) *from = lane;
+      for (int other = 0; LANE_OVERFLOW && *from < 0 && other < lanes(); other++) {
+        if (bounded_buffer_readable[other] > 0) *from = other;
+      }
+      if (*from >= 0) break;
 
-    // assert readable is valid
-    assert(bounded_buffer_readable <= (size_t) BOUNDED_BUFFER_SIZE - 1 && "must have less entries than buffer size (-1 since we just took one)");
-  
-    // signal
-    pthread_cond_signal(&bounded_buffer_put_cond);
+      // nothing readable and nothing more coming
+      if (bounded_buffer_put_total == (size_t) NUMBER_OF_MATRICES) break;
+
+      // nothing to read, wait until a slot fills.
+      bounded_buffer_waiting[lane] += 1;
+      pthread_cond_wait(&bounded_buffer_get_cond[lane], &bounded_buffer_mutex);
+      bounded_buffer_waiting[lane] -= 1;
+      if (bounded_buffer_signalled[lane] > 0) bounded_buffer_signalled[lane] -= 1;
+    }
+
+    // get the value from the matrix
+    if (*from >= 0) value = take(*from);
 
   // unlock
   pthread_mutex_unlock(&bounded_buffer_mutex);
@@ -146,6 +306,16 @@ Matrix * get() {
   return value;
 }
 
+/// Thread safe
+/// Returns the number of matrices currently sitting in the bounded buffer.
+size_t occupancy() {
+  pthread_mutex_lock(&bounded_buffer_mutex);
+  size_t readable = 0;
+  for (int lane = 0; lane < LANES; lane++) readable += bounded_buffer_readable[lane];
+  pthread_mutex_unlock(&bounded_buffer_mutex);
+  return readable;
+}
+
 // Matrix PRODUCER worker thread
 void *prod_worker(void *arg) {
   // initialize prod_count
@@ -155,30 +325,169 @@ void *prod_worker(void *arg) {
   ProdConsStats *prodcons = calloc(1, sizeof(ProdConsStats));
   if (prodcons == NULL) return NULL;
 
+  // claim our live metrics slot and profiling counters
+  metrics_slot_t *metrics = metrics_register();
+  profile_thread_t *prof = profile_register();
+
   // 
-  while (claim_cnt(prod_count, NUMBER_OF_MATRICES, 1)) {
+  int idx;
+  while ((idx = claim_idx_cnt(prod_count, NUMBER_OF_MATRICES)) >= 0) {
 
     // increment matrixtotal
     prodcons->matrixtotal += 1;
 
-    // generate random matrix
-    Matrix *matrix = GenMatrixRandom();
+    // generate random matrix, matrix `idx` of the seeded workload when deterministic
+    profile_begin(prof, PHASE_GENERATE);
+    Matrix *matrix = SEED >= 0 ? GenMatrixSeeded(SEED, idx) : GenMatrixRandom();
+    profile_end(prof);
 
     // assert that matrix can't be null
     assert(matrix != NULL && "generated matrix musn't be NULL");
     assert(matrix->m != NULL && "generated matrix's elements cannot be NULL");
 
+    // number it, the ordered ring and the record go by id
+    matrix->id = idx;
+
     // add sumMatrix to sumtotal
     prodcons->sumtotal += SumMatrix(matrix);
     
     // put matrix in bounded buffer
+    profile_begin(prof, PHASE_ENQUEUE);
     put(matrix);
+    profile_end(prof);
+    metrics_inc(&metrics->produced);
   }
 
   // return prodcons
   return prodcons;
 }
 
+int latency_init(size_t capacity) {
+  for (int cls = 0; cls < LANES; cls++) {
+    latency_queue[cls] = calloc(capacity, sizeof(unsigned long long));
+    latency_mult[cls] = calloc(capacity, sizeof(unsigned long long));
+    if (latency_queue[cls] == NULL || latency_mult[cls] == NULL) return -1;
+    atomic_init(&latency_count[cls], 0);
+  }
+  latency_capacity = capacity;
+  return 0;
+}
+
+/// Thread safe
+/// Records one multiplied pair of class `cls`: how long rhs sat in the buffer, and get to multiply done.
+static void latency_record(int cls, unsigned long long queue_ns, unsigned long long mult_ns) {
+  if (latency_capacity == 0) return;
+  size_t i = atomic_fetch_add_explicit(&latency_count[cls], 1, memory_order_relaxed);
+  if (i >= latency_capacity) return;
+  latency_queue[cls][i] = queue_ns;
+  latency_mult[cls][i] = mult_ns;
+}
+
+static int cmp_ull(const void *a, const void *b) {
+  unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+  return (x > y) - (x < y);
+}
+
+/// the p-th percentile of `n` sorted samples in microseconds
+static double percentile_us(unsigned long long *sorted, size_t n, int p) {
+  return n ? sorted[(n - 1) * p / 100] / 1e3 : 0.0;
+}
+
+void latency_report(FILE *stream) {
+  if (latency_capacity == 0) return;
+
+  static const char *class_names[LANES] = { "small", "large" };
+  fprintf(stream, "\nLatency per size class (us):\n");
+  fprintf(stream, "%-6s %8s %10s %10s %12s %12s\n", "class", "pairs", "queue_p50", "queue_p99", "get_mult_p50", "get_mult_p99");
+  for (int cls = 0; cls < LANES; cls++) {
+    size_t n = atomic_load(&latency_count[cls]);
+    if (n > latency_capacity) n = latency_capacity;
+    qsort(latency_queue[cls], n, sizeof(unsigned long long), cmp_ull);
+    qsort(latency_mult[cls], n, sizeof(unsigned long long), cmp_ull);
+    fprintf(stream, "%-6s %8zu %10.1f %10.1f %12.1f %12.1f\n", class_names[cls], n,
+            percentile_us(latency_queue[cls], n, 50), percentile_us(latency_queue[cls], n, 99),
+            percentile_us(latency_mult[cls], n, 50), percentile_us(latency_mult[cls], n, 99));
+    free(latency_queue[cls]);
+    free(latency_mult[cls]);
+    latency_queue[cls] = latency_mult[cls] = NULL;
+  }
+  latency_capacity = 0;
+}
+
+/// Starts choosing a pair, only one consumer at a time when `ordered`
+static void pairing_begin() {
+  if (ordered()) pthread_mutex_lock(&pairing_lock);
+}
+
+/// Done choosing a pair, or giving up on one
+static void pairing_end() {
+  if (ordered()) pthread_mutex_unlock(&pairing_lock);
+}
+
+/// One line of the record, kept until `record_flush` so the file is in pairing order
+typedef struct __pair_record_t {
+  int lhs_id, rhs_id;
+  int lhs_rows, lhs_cols, rhs_rows, rhs_cols;
+  int sum;
+} pair_record_t;
+
+/// Pair records indexed by pair, NULL unless `record_init` was called
+pair_record_t *pair_records = NULL;
+size_t pair_records_capacity = 0;
+
+int record_init(size_t capacity) {
+  pair_records = calloc(capacity, sizeof(pair_record_t));
+  if (pair_records == NULL) return -1;
+  pair_records_capacity = capacity;
+  return 0;
+}
+
+/// Thread safe, each pair index is written by exactly one consumer
+static void record_pair(int pair, Matrix *lhs, Matrix *rhs, Matrix *mult) {
+  if (pair_records == NULL) return;
+  assert((size_t) pair < pair_records_capacity && "more pairs than matrices / 2");
+  pair_records[pair] = (pair_record_t) {
+    lhs->id, rhs->id, lhs->rows, lhs->cols, rhs->rows, rhs->cols, SumMatrix(mult)
+  };
+}
+
+void record_flush(FILE *stream) {
+  if (pair_records == NULL) return;
+
+  int pairs = atomic_load(&next_pair);
+  for (int i = 0; i < pairs; i++) {
+    pair_record_t *r = &pair_records[i];
+    fprintf(stream, "pair lhs=%d rhs=%d lhs_shape=%dx%d rhs_shape=%dx%d sum=%d\n",
+            r->lhs_id, r->rhs_id, r->lhs_rows, r->lhs_cols, r->rhs_rows, r->rhs_cols, r->sum);
+  }
+
+  free(pair_records);
+  pair_records = NULL;
+  pair_records_capacity = 0;
+}
+
+/// Claims and gets the next matrix for a consumer serving `lane`, storing the lane it came from in `from`.
+/// Returns NULL once there is nothing left for this consumer.
+static Matrix *next_matrix(counter_t *cons_count, profile_thread_t *prof, int lane, int *from) {
+  Matrix *value = NULL;
+
+  if (LANE_LIMIT > 0) {
+    // routed lanes finish when drained, claims can't be known ahead of time per lane
+    // a drained lane isn't a dequeue, drop the measurement rather than end it
+    profile_begin(prof, PHASE_DEQUEUE);
+    value = get_lane(lane, from);
+    if (value != NULL) profile_end(prof);
+  } else if (claim_cnt(cons_count, NUMBER_OF_MATRICES, 1)) {
+    // only a successful claim is a dequeue
+    profile_begin(prof, PHASE_DEQUEUE);
+    *from = LANE_SMALL;
+    value = get();
+    profile_end(prof);
+  }
+
+  return value;
+}
+
 // Matrix CONSUMER worker thread
 void *cons_worker(void *arg) {
 
@@ -194,62 +503,84 @@ void *cons_worker(void *arg) {
   // return null if we failed to allocate
   if (prodcons == NULL) return NULL;
 
-  // claim matrices
-  while (claim_cnt(cons_count, NUMBER_OF_MATRICES, 1)) {
+  // claim our live metrics slot and profiling counters
+  metrics_slot_t *metrics = metrics_register();
+  profile_thread_t *prof = profile_register();
+
+  // the lane this consumer serves, and the lane its current lhs came from
+  int lane = consumer_lane(), from = lane, rhs_from = lane;
 
-    // get lhs, returns if nothing in bounded buffer
-    if ((lhs = get()) == NULL) return prodcons;
+  for (;;) {
+    // when ordered only one consumer chooses a pair at a time, so pairs follow id order
+    pairing_begin();
+
+    // claim matrices, get lhs, returns if nothing in bounded buffer
+    if ((lhs = next_matrix(cons_count, prof, lane, &from)) == NULL) break;
 
     // increment matrix and sumMatrix
     prodcons->matrixtotal += 1;
     prodcons->sumtotal += SumMatrix(lhs);
+    metrics_inc(&metrics->consumed);
+
+    // get 2nd matrix, preferring the lane lhs came from (another lane may still hand one over with overflow)
+    while ((rhs = next_matrix(cons_count, prof, from, &rhs_from)) != NULL) {
 
-    // get 2nd matrix
-    while (claim_cnt(cons_count, NUMBER_OF_MATRICES, 1)) {
-      
-      // get rhs, returns if nothing in bounded buffer
-      if ((rhs = get()) == NULL) {
-        // frees lhs
-        FreeMatrix(lhs);
-        return prodcons;
-      };
+      // when rhs left the buffer, for the latency figures
+      unsigned long long got_ns = latency_capacity > 0 ? now_ns() : 0;
 
       // increment matrix total and sumtotal
       prodcons->matrixtotal += 1;
       prodcons->sumtotal += SumMatrix(rhs);
+      metrics_inc(&metrics->consumed);
 
       // asserts lhs and rhs aren't null
       assert(lhs != NULL);
       assert(rhs != NULL);
 
+      // free rhs if it can't be multiplied with lhs
+      if (lhs->cols != rhs->rows) {
+        FreeMatrix(rhs);
+        continue;
+      }
+
+      // the pair is chosen, let the next consumer pick while we multiply
+      int pair = atomic_fetch_add(&next_pair, 1);
+      pairing_end();
+
+      // multiply matrices outside the stdout lock so a large multiply doesn't stall other consumers
+      profile_begin(prof, PHASE_MULTIPLY);
+      mult = MatrixMultiply(lhs, rhs);
+      profile_end(prof);
+      assert(mult != NULL && "a chosen pair must multiply");
+      if (latency_capacity > 0) latency_record(size_class(rhs), got_ns - rhs->put_ns, now_ns() - got_ns);
+      record_pair(pair, lhs, rhs, mult);
+
       // lock
       pthread_mutex_lock(&stdout_lock);
-        // multiply matrices, prints if not null
-        if ((mult = MatrixMultiply(lhs, rhs)) != NULL) {
-          DisplayMatrix(lhs, stdout);
-          printf("    X\n");
-          DisplayMatrix(rhs, stdout);
-          printf("    =\n");
-          DisplayMatrix(mult, stdout);
-        };
+        profile_begin(prof, PHASE_OUTPUT);
+        printf("MULTIPLY (%d x %d) BY (%d x %d):\n", lhs->rows, lhs->cols, rhs->rows, rhs->cols);
+        DisplayMatrix(lhs, stdout);
+        printf("    X\n");
+        DisplayMatrix(rhs, stdout);
+        printf("    =\n");
+        DisplayMatrix(mult, stdout);
+        profile_end(prof);
 
       // unlock
       pthread_mutex_unlock(&stdout_lock);
 
-      // if mult wasn't null goto finish
-      if (mult != NULL) goto finish;
-
-      // free rhs if mult was null
-      FreeMatrix(rhs);
+      goto finish;
     }
 
-    // free lhs if mult was null
+    // free lhs if nothing left to pair it with
+    pairing_end();
     FreeMatrix(lhs);
     return prodcons;
 
   finish:
     // increment multtotal
     prodcons->multtotal += 1;
+    metrics_inc(&metrics->multiplied);
 
     // free lhs, rhs, and mult
     FreeMatrix(lhs);
@@ -257,5 +588,7 @@ void *cons_worker(void *arg) {
     FreeMatrix(mult);
   }
 
+  // nothing left to claim
+  pairing_end();
   return prodcons;
 }
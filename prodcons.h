@@ -7,8 +7,16 @@
  */
 
 /// ring buffer. Should call `get` or `put` to use.
+/// With size-class routing each lane owns `BOUNDED_BUFFER_SIZE` consecutive slots.
 Matrix ** bigmatrix;
 
+// SIZE-CLASS LANES
+// lane 0 holds small matrices, and is the only lane when routing is disabled
+// lane 1 holds matrices with more than `LANE_LIMIT` elements
+#define LANES 2
+#define LANE_SMALL 0
+#define LANE_LARGE 1
+
 // PRODUCER-CONSUMER put() get() function prototypes
 
 // Data structure to track matrix production / consumption stats
@@ -28,3 +36,28 @@ void *cons_worker(void *arg);
 // Routines to add and remove matrices from the bounded buffer
 int put(Matrix *value);
 Matrix * get();
+Matrix * get_lane(int lane, int *from);
+/// number of lanes in use
+int lanes();
+/// size class of a matrix, whether or not routing is enabled
+int size_class(Matrix *value);
+/// lane a matrix is routed to
+int lane_of(Matrix *value);
+/// lane the calling consumer serves
+int consumer_lane();
+/// number of matrices currently in the bounded buffer
+size_t occupancy();
+
+// Record of multiplied pairs, see `RECORD` in pcmatrix.h
+/// starts recording up to `capacity` pairs
+/// returns -1 if it failed to allocate
+int record_init(size_t capacity);
+/// writes every recorded pair to `stream` in pairing order and frees them, no-op unless `record_init` succeeded
+void record_flush(FILE *stream);
+
+// Per size class latency of multiplied pairs
+/// starts recording up to `capacity` samples per class
+/// returns -1 if it failed to allocate
+int latency_init(size_t capacity);
+/// prints p50/p99 per class to `stream` and frees the samples, no-op unless `latency_init` succeeded
+void latency_report(FILE *stream);
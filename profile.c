@@ -0,0 +1,216 @@
+/*
+ *  profile module
+ *  Per-phase profiling with perf_event_open counters
+ *
+ *  Each worker opens its own cycles, instructions, LLC miss, context
+ *  switch and dTLB miss counters as one perf_event group, so a phase boundary costs a
+ *  single read(). Counters the kernel denies are left out, and if none can
+ *  be opened the phase is still timed with CLOCK_MONOTONIC. When the group
+ *  is multiplexed or not scheduled, counts are scaled by time enabled over
+ *  time running and the table shows how much of each phase was counted.
+ *
+ *  University of Washington, Tacoma
+ *  TCSS 422 - Operating Systems
+ */
+
+// Include libraries required for this module only
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "profile.h"
+
+/// One entry per worker thread, NULL when profiling is disabled
+profile_thread_t *profile_threads = NULL;
+int profile_nthreads = 0;
+/// Next entry to hand out in `profile_register`
+atomic_int profile_next_thread = 0;
+
+static const char *phase_names[PHASE_COUNT] = {
+  "generate", "enqueue", "dequeue", "multiply", "output"
+};
+
+static const char *counter_names[COUNTER_COUNT] = {
+  "cycles", "instructions", "llc_misses", "ctx_switches", "dtlb_misses"
+};
+
+static const struct { unsigned int type; unsigned long long config; } counter_events[COUNTER_COUNT] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+  { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+                        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+static unsigned long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// opens one counter on the calling thread, retrying user-space only if the
+/// kernel refuses to count kernel events (perf_event_paranoid >= 2)
+static int perf_open(profile_counter_t counter, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = counter_events[counter].type;
+  attr.config = counter_events[counter].config;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_hv = 1;
+
+  int fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+  if (fd < 0) {
+    attr.exclude_kernel = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+  }
+  return fd;
+}
+
+/// reads every open counter of the group into `out`, indexed by profile_counter_t,
+/// along with how long the group has been enabled and actually running on the PMU
+static void perf_read(profile_thread_t *p, unsigned long long out[COUNTER_COUNT],
+                      unsigned long long *enabled, unsigned long long *running) {
+  // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, then one value per member in open order
+  unsigned long long buf[3 + COUNTER_COUNT];
+  memset(out, 0, sizeof(unsigned long long) * COUNTER_COUNT);
+  *enabled = *running = 0;
+  if (p->group_fd < 0) return;
+  if (read(p->group_fd, buf, sizeof(buf)) < (ssize_t) (3 * sizeof(unsigned long long))) return;
+
+  *enabled = buf[1];
+  *running = buf[2];
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    if (p->slot[c] >= 0 && (unsigned long long) p->slot[c] < buf[0]) out[c] = buf[3 + p->slot[c]];
+  }
+}
+
+int profile_init(int nthreads) {
+  assert(nthreads > 0 && "must have at least one thread");
+
+  profile_threads = calloc(nthreads, sizeof(profile_thread_t));
+  if (profile_threads == NULL) return -1;
+
+  profile_nthreads = nthreads;
+  atomic_store(&profile_next_thread, 0);
+  return 0;
+}
+
+profile_thread_t *profile_register() {
+  if (profile_threads == NULL) return NULL;
+
+  int idx = atomic_fetch_add(&profile_next_thread, 1);
+  assert(idx < profile_nthreads && "more workers registered than threads allocated");
+  profile_thread_t *p = &profile_threads[idx];
+
+  p->group_fd = -1;
+  p->nopen = 0;
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    // the first counter that opens leads the group
+    p->fds[c] = perf_open(c, p->group_fd);
+    p->slot[c] = p->fds[c] >= 0 ? p->nopen++ : -1;
+    if (p->group_fd < 0 && p->fds[c] >= 0) p->group_fd = p->fds[c];
+  }
+
+  return p;
+}
+
+void profile_begin(profile_thread_t *p, profile_phase_t phase) {
+  if (p == NULL) return;
+
+  p->phase = phase;
+  perf_read(p, p->start, &p->start_enabled, &p->start_running);
+  p->start_ns = now_ns();
+}
+
+void profile_end(profile_thread_t *p) {
+  if (p == NULL) return;
+
+  unsigned long long end_ns = now_ns();
+  unsigned long long end[COUNTER_COUNT], end_enabled, end_running;
+  perf_read(p, end, &end_enabled, &end_running);
+
+  unsigned long long enabled = end_enabled - p->start_enabled;
+  unsigned long long running = end_running - p->start_running;
+
+  p->calls[p->phase] += 1;
+  p->ns[p->phase] += end_ns - p->start_ns;
+  p->enabled[p->phase] += enabled;
+  p->running[p->phase] += running;
+
+  // a phase the group never ran for has nothing to scale, it only lowers the counted share
+  if (running == 0) return;
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    unsigned long long delta = end[c] - p->start[c];
+    p->counts[p->phase][c] += running < enabled ? (unsigned long long) ((double) delta * enabled / running) : delta;
+  }
+}
+
+void profile_report(FILE *stream) {
+  if (profile_threads == NULL) return;
+
+  unsigned long long calls[PHASE_COUNT] = {0};
+  unsigned long long ns[PHASE_COUNT] = {0};
+  unsigned long long counts[PHASE_COUNT][COUNTER_COUNT] = {{0}};
+  unsigned long long enabled[PHASE_COUNT] = {0};
+  unsigned long long running[PHASE_COUNT] = {0};
+  // a counter is only reported if every registered thread managed to open it
+  int available[COUNTER_COUNT];
+  for (int c = 0; c < COUNTER_COUNT; c++) available[c] = 1;
+
+  int registered = atomic_load(&profile_next_thread);
+  for (int t = 0; t < registered; t++) {
+    profile_thread_t *p = &profile_threads[t];
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+      if (p->fds[c] < 0) available[c] = 0;
+      else close(p->fds[c]);
+    }
+    for (int ph = 0; ph < PHASE_COUNT; ph++) {
+      calls[ph] += p->calls[ph];
+      ns[ph] += p->ns[ph];
+      enabled[ph] += p->enabled[ph];
+      running[ph] += p->running[ph];
+      for (int c = 0; c < COUNTER_COUNT; c++) counts[ph][c] += p->counts[ph][c];
+    }
+  }
+
+  int any = 0;
+  for (int c = 0; c < COUNTER_COUNT; c++) any |= available[c];
+  fprintf(stream, "\nProfile (%s):\n", any ? "perf_event counters" : "perf_event unavailable, clock timing only");
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    if (!available[c]) fprintf(stream, "  %s: unavailable\n", counter_names[c]);
+  }
+
+  fprintf(stream, "%-10s %10s %12s %10s", "phase", "calls", "time_ms", "ns/call");
+  for (int c = 0; c < COUNTER_COUNT; c++) if (available[c]) fprintf(stream, " %14s", counter_names[c]);
+  if (available[COUNTER_CYCLES] && available[COUNTER_INSTRUCTIONS]) fprintf(stream, " %6s", "ipc");
+  if (any) fprintf(stream, " %9s", "counted%");
+  fprintf(stream, "\n");
+
+  for (int ph = 0; ph < PHASE_COUNT; ph++) {
+    fprintf(stream, "%-10s %10llu %12.3f %10.0f", phase_names[ph], calls[ph], ns[ph] / 1e6,
+            calls[ph] ? (double) ns[ph] / calls[ph] : 0.0);
+    for (int c = 0; c < COUNTER_COUNT; c++) if (available[c]) fprintf(stream, " %14llu", counts[ph][c]);
+    if (available[COUNTER_CYCLES] && available[COUNTER_INSTRUCTIONS])
+      fprintf(stream, " %6.2f", counts[ph][COUNTER_CYCLES]
+              ? (double) counts[ph][COUNTER_INSTRUCTIONS] / counts[ph][COUNTER_CYCLES] : 0.0);
+    // share of the phase the PMU actually counted, '*' when the counts above are scaled estimates
+    if (any) fprintf(stream, " %8.1f%s", enabled[ph] ? 100.0 * running[ph] / enabled[ph] : 0.0,
+                     running[ph] < enabled[ph] ? "*" : " ");
+    fprintf(stream, "\n");
+  }
+  int scaled = 0;
+  for (int ph = 0; ph < PHASE_COUNT; ph++) scaled |= running[ph] < enabled[ph];
+  if (scaled) fprintf(stream, "* multiplexed or unscheduled, counts scaled by time enabled / time running\n");
+
+  free(profile_threads);
+  profile_threads = NULL;
+  profile_nthreads = 0;
+}
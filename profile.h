@@ -0,0 +1,70 @@
+/*
+ *  profile header
+ *  Function prototypes, data, and constants for the per-phase profiling module
+ *
+ *  University of Washington, Tacoma
+ *  TCSS 422 - Operating Systems
+ */
+
+// PER-PHASE PROFILING
+
+/// Phases of `prod_worker` / `cons_worker` that are attributed separately
+typedef enum __profile_phase_t {
+  PHASE_GENERATE,
+  PHASE_ENQUEUE,
+  PHASE_DEQUEUE,
+  PHASE_MULTIPLY,
+  PHASE_OUTPUT,
+  PHASE_COUNT
+} profile_phase_t;
+
+/// Hardware/software counters read around every phase
+typedef enum __profile_counter_t {
+  COUNTER_CYCLES,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_LLC_MISSES,
+  COUNTER_CONTEXT_SWITCHES,
+  COUNTER_DTLB_MISSES,
+  COUNTER_COUNT
+} profile_counter_t;
+
+/// Per-thread profiling state. Only the owning thread writes to it,
+/// `profile_report` reads it after every worker has been joined.
+typedef struct __profile_thread_t {
+  /// perf_event group leader, -1 if no counter could be opened
+  int group_fd;
+  /// fds of each counter, -1 if the kernel denied that one
+  int fds[COUNTER_COUNT];
+  /// position of each counter in a PERF_FORMAT_GROUP read, -1 if not opened
+  int slot[COUNTER_COUNT];
+  int nopen;
+
+  /// phase currently being measured and its starting values
+  profile_phase_t phase;
+  unsigned long long start_ns;
+  unsigned long long start[COUNTER_COUNT];
+  /// group time enabled/running when the phase began, they differ once the PMU multiplexes us
+  unsigned long long start_enabled;
+  unsigned long long start_running;
+
+  /// accumulated totals per phase, counts are scaled by enabled/running
+  unsigned long long calls[PHASE_COUNT];
+  unsigned long long ns[PHASE_COUNT];
+  unsigned long long counts[PHASE_COUNT][COUNTER_COUNT];
+  unsigned long long enabled[PHASE_COUNT];
+  unsigned long long running[PHASE_COUNT];
+} profile_thread_t;
+
+// profile methods
+/// allocates per-thread state for `nthreads` workers, must be called before any worker is created
+/// returns -1 if it failed to allocate
+int profile_init(int nthreads);
+/// called by each worker on its own thread, opens that thread's counters
+/// returns NULL if profiling is disabled, which makes `profile_begin`/`profile_end` no-ops
+profile_thread_t *profile_register();
+/// starts measuring `phase` on the calling thread
+void profile_begin(profile_thread_t *p, profile_phase_t phase);
+/// stops measuring the phase started by `profile_begin` and accumulates the deltas
+void profile_end(profile_thread_t *p);
+/// closes every counter, prints a per-phase table to `stream` and frees the state
+void profile_report(FILE *stream);
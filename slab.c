@@ -0,0 +1,310 @@
+/*
+ *  slab module
+ *  Huge-page backed slab allocator for matrices and the ring buffer
+ *
+ *  One mapping is reserved up front, preferring explicit 1GB or 2MB
+ *  huge pages, then a transparent huge page hint, then normal pages.
+ *  Blocks up to 64KB are power-of-two size classes recycled through
+ *  per-class free lists. Larger blocks are carved at page granularity,
+ *  so a big matrix doesn't pay for a doubled footprint, and recycled
+ *  best fit. Both are carved off the slab with an atomic bump pointer.
+ *  Anything that doesn't fit, or any allocation when the slab is
+ *  disabled, falls back to malloc.
+ *
+ *  University of Washington, Tacoma
+ *  TCSS 422 - Operating Systems
+ */
+
+// Include libraries required for this module only
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "slab.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define SLAB_2MB (2UL << 20)
+#define SLAB_1GB (1UL << 30)
+
+/// Smallest block is 64 bytes (one cache line), class k holds 64 << k bytes, up to 64KB
+#define SLAB_MIN_SHIFT 6
+#define SLAB_CLASSES 11
+/// Class stored in the header of blocks bigger than the last class, sized in whole pages
+#define SLAB_LARGE ((size_t) SLAB_CLASSES)
+#define SLAB_PAGE 4096UL
+/// Class stored in the header of blocks that came from malloc
+#define SLAB_MALLOC ((size_t) -1)
+
+/// Prefix of every block, keeps the payload 16 byte aligned
+typedef struct __slab_header_t {
+  size_t cls;
+  /// bytes the block occupies in the slab, header included
+  size_t size;
+} slab_header_t;
+
+/// Free block, the link lives in the payload
+typedef struct __slab_free_t {
+  struct __slab_free_t *next;
+} slab_free_t;
+
+/// The mapping, NULL when disabled
+char *slab_base = NULL;
+size_t slab_size = 0;
+slab_backing_t slab_kind = SLAB_DISABLED;
+/// Bump pointer into the mapping, never moves back
+atomic_size_t slab_used = 0;
+/// Bytes of slab blocks currently handed out
+atomic_size_t slab_live = 0;
+/// Allocations that had to go to malloc because the slab was full or the block too big
+atomic_size_t slab_fallbacks = 0;
+
+/// Protects slab_free_lists[k]
+pthread_mutex_t slab_class_lock[SLAB_CLASSES];
+slab_free_t *slab_free_lists[SLAB_CLASSES];
+/// Protects slab_large_free, freed SLAB_LARGE blocks of any size
+pthread_mutex_t slab_large_lock = PTHREAD_MUTEX_INITIALIZER;
+slab_free_t *slab_large_free = NULL;
+
+static const char *backing_names[] = {
+  "disabled (malloc)", "hugetlb 1GB pages", "hugetlb 2MB pages", "transparent huge pages requested", "normal pages"
+};
+
+/// reserves `bytes` off the end of the slab, leaving the bump pointer alone if they don't fit
+/// returns NULL if the slab is full
+static void *slab_carve(size_t bytes) {
+  size_t offset = atomic_load(&slab_used);
+  do {
+    if (bytes > slab_size - offset) return NULL;
+  } while (!atomic_compare_exchange_weak(&slab_used, &offset, offset + bytes));
+  return slab_base + offset;
+}
+
+/// the smallest class whose blocks hold `size` bytes plus the header
+static size_t slab_class_of(size_t size) {
+  size_t cls = 0;
+  while (cls < SLAB_CLASSES && ((size_t) 1 << (SLAB_MIN_SHIFT + cls)) < size + sizeof(slab_header_t)) cls++;
+  return cls;
+}
+
+static void *try_map(size_t bytes, int flags) {
+  void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+/// maps `bytes` of normal pages starting on a 2MB boundary, so THP can back every 2MB of it
+static void *try_map_aligned(size_t bytes) {
+  char *p = try_map(bytes + SLAB_2MB, 0);
+  if (p == NULL) return NULL;
+
+  // trim the unaligned head and the leftover tail
+  char *aligned = (char *) (((uintptr_t) p + SLAB_2MB - 1) & ~(uintptr_t) (SLAB_2MB - 1));
+  if (aligned > p) munmap(p, aligned - p);
+  if (aligned + bytes < p + bytes + SLAB_2MB) munmap(aligned + bytes, p + bytes + SLAB_2MB - (aligned + bytes));
+  return aligned;
+}
+
+/// KB of the slab actually backed by transparent huge pages, from /proc/self/smaps
+/// returns -1 if it can't be read
+static long slab_thp_kb() {
+  FILE *smaps = fopen("/proc/self/smaps", "r");
+  if (smaps == NULL) return -1;
+
+  char line[256];
+  long kb = -1;
+  int inside = 0;
+  while (fgets(line, sizeof(line), smaps) != NULL) {
+    unsigned long start, end;
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+      // a new mapping, is it the one holding the slab
+      inside = start <= (uintptr_t) slab_base && (uintptr_t) slab_base < end;
+    } else if (inside && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+      break;
+    }
+  }
+
+  fclose(smaps);
+  return kb;
+}
+
+int slab_init(size_t bytes) {
+  for (int k = 0; k < SLAB_CLASSES; k++) {
+    pthread_mutex_init(&slab_class_lock[k], NULL);
+    slab_free_lists[k] = NULL;
+  }
+  slab_large_free = NULL;
+  atomic_store(&slab_used, 0);
+  atomic_store(&slab_live, 0);
+  atomic_store(&slab_fallbacks, 0);
+
+  slab_kind = SLAB_DISABLED;
+  if (bytes == 0) return 0;
+
+  // round up to whole 2MB pages so any huge page size can back it
+  slab_size = (bytes + SLAB_2MB - 1) & ~(SLAB_2MB - 1);
+
+  if (slab_size % SLAB_1GB == 0 && (slab_base = try_map(slab_size, MAP_HUGETLB | MAP_HUGE_1GB)) != NULL) {
+    slab_kind = SLAB_HUGETLB_1GB;
+  } else if ((slab_base = try_map(slab_size, MAP_HUGETLB | MAP_HUGE_2MB)) != NULL) {
+    slab_kind = SLAB_HUGETLB_2MB;
+  } else if ((slab_base = try_map_aligned(slab_size)) != NULL) {
+    // no reserved huge pages, ask for transparent ones instead, `slab_report` checks whether we got them
+    slab_kind = madvise(slab_base, slab_size, MADV_HUGEPAGE) == 0 ? SLAB_THP : SLAB_NORMAL;
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+/// takes the smallest freed large block that holds `bytes`, splitting off a tail worth reusing
+/// returns NULL if none fits
+static slab_header_t *slab_large_reuse(size_t bytes) {
+  slab_header_t *block = NULL;
+
+  pthread_mutex_lock(&slab_large_lock);
+    slab_free_t **best = NULL;
+    for (slab_free_t **it = &slab_large_free; *it != NULL; it = &(*it)->next) {
+      size_t have = ((slab_header_t *) *it - 1)->size;
+      if (have >= bytes && (best == NULL || have < ((slab_header_t *) *best - 1)->size)) best = it;
+    }
+
+    if (best != NULL) {
+      block = (slab_header_t *) *best - 1;
+      *best = (*best)->next;
+
+      // a tail too big for the small classes goes back on the list
+      if (block->size - bytes > ((size_t) 1 << (SLAB_MIN_SHIFT + SLAB_CLASSES - 1))) {
+        slab_header_t *tail = (slab_header_t *) ((char *) block + bytes);
+        tail->cls = SLAB_LARGE;
+        tail->size = block->size - bytes;
+        slab_free_t *node = (slab_free_t *) (tail + 1);
+        node->next = slab_large_free;
+        slab_large_free = node;
+        block->size = bytes;
+      }
+    }
+  pthread_mutex_unlock(&slab_large_lock);
+
+  return block;
+}
+
+void *slab_alloc(size_t size) {
+  size_t cls = slab_class_of(size);
+  slab_header_t *block = NULL;
+  size_t bytes = 0;
+
+  if (slab_base != NULL && cls < SLAB_CLASSES) {
+    bytes = (size_t) 1 << (SLAB_MIN_SHIFT + cls);
+
+    // recycle a freed block of the same class first
+    pthread_mutex_lock(&slab_class_lock[cls]);
+      slab_free_t *head = slab_free_lists[cls];
+      if (head != NULL) slab_free_lists[cls] = head->next;
+    pthread_mutex_unlock(&slab_class_lock[cls]);
+
+    if (head != NULL) {
+      block = (slab_header_t *) head - 1;
+    } else {
+      // carve a new block, a block that doesn't fit leaves room for smaller ones
+      block = slab_carve(bytes);
+    }
+  } else if (slab_base != NULL) {
+    // too big for a class, take whole pages instead of rounding up to a power of two
+    cls = SLAB_LARGE;
+    bytes = (size + sizeof(slab_header_t) + SLAB_PAGE - 1) & ~(SLAB_PAGE - 1);
+    // a reused block keeps its size, it may be a little bigger than asked for
+    if ((block = slab_large_reuse(bytes)) != NULL) bytes = block->size;
+    else block = slab_carve(bytes);
+  }
+
+  if (block == NULL) {
+    if (slab_base != NULL) atomic_fetch_add(&slab_fallbacks, 1);
+    block = malloc(sizeof(slab_header_t) + size);
+    if (block == NULL) return NULL;
+    cls = SLAB_MALLOC;
+    bytes = 0;
+  }
+
+  block->cls = cls;
+  block->size = bytes;
+  atomic_fetch_add(&slab_live, bytes);
+  return block + 1;
+}
+
+void *slab_calloc(size_t n, size_t size) {
+  void *p = slab_alloc(n * size);
+  if (p != NULL) memset(p, 0, n * size);
+  return p;
+}
+
+void slab_free(void *ptr) {
+  if (ptr == NULL) return;
+
+  slab_header_t *block = (slab_header_t *) ptr - 1;
+  if (block->cls == SLAB_MALLOC) {
+    free(block);
+    return;
+  }
+
+  assert(block->cls <= SLAB_LARGE && "corrupt slab header");
+  assert((char *) block >= slab_base && (char *) block < slab_base + slab_size && "block must be within the slab");
+
+  atomic_fetch_sub(&slab_live, block->size);
+
+  slab_free_t *node = ptr;
+  if (block->cls == SLAB_LARGE) {
+    pthread_mutex_lock(&slab_large_lock);
+      node->next = slab_large_free;
+      slab_large_free = node;
+    pthread_mutex_unlock(&slab_large_lock);
+    return;
+  }
+
+  pthread_mutex_lock(&slab_class_lock[block->cls]);
+    node->next = slab_free_lists[block->cls];
+    slab_free_lists[block->cls] = node;
+  pthread_mutex_unlock(&slab_class_lock[block->cls]);
+}
+
+slab_backing_t slab_backing() {
+  return slab_kind;
+}
+
+void slab_report(FILE *stream) {
+  if (slab_kind == SLAB_DISABLED) {
+    fprintf(stream, "Slab: %s\n", backing_names[slab_kind]);
+    return;
+  }
+
+  fprintf(stream, "Slab: %s, %zu MB reserved, %zu KB carved, %zu KB still handed out, %zu malloc fallbacks\n",
+          backing_names[slab_kind], slab_size >> 20, atomic_load(&slab_used) >> 10,
+          atomic_load(&slab_live) >> 10, atomic_load(&slab_fallbacks));
+
+  // madvise succeeding doesn't mean the kernel used huge pages, ask it what it actually did
+  if (slab_kind == SLAB_THP) {
+    long kb = slab_thp_kb();
+    if (kb < 0) fprintf(stream, "Slab: could not read /proc/self/smaps to confirm huge pages\n");
+    else if (kb == 0) fprintf(stream, "Slab: no part of it is backed by huge pages, effectively normal pages\n");
+    else fprintf(stream, "Slab: %ld KB backed by transparent huge pages\n", kb);
+  }
+}
+
+void slab_destroy() {
+  if (slab_base != NULL) munmap(slab_base, slab_size);
+  slab_base = NULL;
+  slab_size = 0;
+  slab_kind = SLAB_DISABLED;
+}
@@ -0,0 +1,35 @@
+/*
+ *  slab header
+ *  Function prototypes, data, and constants for the huge-page slab allocator module
+ *
+ *  University of Washington, Tacoma
+ *  TCSS 422 - Operating Systems
+ */
+
+// HUGE-PAGE SLAB
+
+/// How the slab was backed, in order of preference
+typedef enum __slab_backing_t {
+  SLAB_DISABLED,
+  SLAB_HUGETLB_1GB,
+  SLAB_HUGETLB_2MB,
+  SLAB_THP,
+  SLAB_NORMAL
+} slab_backing_t;
+
+// slab methods
+/// reserves a slab of at least `bytes`, 0 disables it and every allocation goes to malloc
+/// returns -1 if no mapping at all could be made
+int slab_init(size_t bytes);
+/// thread safe, returns NULL if neither the slab nor malloc could provide `size` bytes
+void *slab_alloc(size_t size);
+/// thread safe, `slab_alloc` followed by zeroing `n * size` bytes
+void *slab_calloc(size_t n, size_t size);
+/// thread safe, accepts NULL
+void slab_free(void *ptr);
+/// which backing `slab_init` ended up with
+slab_backing_t slab_backing();
+/// prints the backing and usage of the slab to `stream`
+void slab_report(FILE *stream);
+/// unmaps the slab, every block must have been freed
+void slab_destroy();